@@ -0,0 +1,55 @@
+// Compares one list of structs with SOA_LIST columns on loops that read one field.
+//
+//   cc -std=gnu11 -O2 -I. bench/soa_bench.c dynamic.c -lm -o soa_bench && ./soa_bench
+
+#include <stdio.h>
+#include <time.h>
+
+#include "dynamic.h"
+
+#if !defined(__APPLE__)
+// assert() in dynamic.h reports through __assert_rtn, which only the macOS libc has
+void __assert_rtn(const char* func, const char* file, int line, const char* expr) {
+    fprintf(stderr, "%s:%d: %s: %s\n", file, line, func, expr);
+    abort();
+}
+#endif
+
+SOA_LIST(Row, (int, id), (double, price), (int, status), (long, ts), (double, qty), (String, name))
+
+static double ms_between(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1e3 + (b.tv_nsec - a.tv_nsec) / 1e6;
+}
+
+int main(void) {
+    size_t n = 10000000;
+    Row* aos = List_new(Row);
+    RowSoA soa = RowSoA_new();
+    for (size_t i = 0; i < n; i++) {
+        Row row = {.id = i, .price = i % 100 * 0.5, .status = i % 3 == 0, .ts = i, .qty = 1};
+        List_append(aos, row);
+        RowSoA_append(&soa, row);
+    }
+
+    printf("%zu rows, sizeof(Row) = %zu\n", n, sizeof(Row));
+    for (int run = 0; run < 5; run++) {
+        struct timespec t0, t1, t2, t3, t4;
+        double aos_sum = 0, soa_sum = 0;
+        size_t aos_count = 0, soa_count = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (size_t i = 0; i < n; i++) aos_sum += aos[i].price;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (size_t i = 0; i < n; i++) soa_sum += soa.price[i];
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        for (size_t i = 0; i < n; i++) aos_count += aos[i].status == 1;
+        clock_gettime(CLOCK_MONOTONIC, &t3);
+        for (size_t i = 0; i < n; i++) soa_count += soa.status[i] == 1;
+        clock_gettime(CLOCK_MONOTONIC, &t4);
+
+        if (aos_sum != soa_sum || aos_count != soa_count) return 1;
+        printf("sum price: AoS %5.1f ms, SoA %5.1f ms | count status == 1: AoS %5.1f ms, SoA %5.1f ms\n",
+               ms_between(t0, t1), ms_between(t1, t2), ms_between(t2, t3), ms_between(t3, t4));
+    }
+    return 0;
+}
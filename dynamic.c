@@ -2,25 +2,55 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <locale.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <tmmintrin.h>  // Used in target("ssse3") functions even when the build is plain SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #define DEBUG 0
 
 typedef struct GCItem {
     void* ptr;
     free_fn_t free_fn;
+    children_fn_t children_fn;
 } GCItem;
 
 static GCItem** gc = NULL;
+static void*** gc_escapes = NULL;  // Objects passed to gc_escape, per frame (NULL if none)
 static size_t gc_tracked = 0, gc_freed = 0, gc_untracked = 0;
 
 static GCItem* gc_pop_frame(void) { return len(gc) > 0 ? gc[len(gc) - 1] : NULL; }
 
+// old_ptr was taken before realloc, as an integer since the pointer itself is no longer valid
+static void gc_update_ptr(uintptr_t old_ptr, void* new_ptr) {
+    GCItem* frame = gc_pop_frame();
+    if (frame == NULL) return;
+    foreach (object, frame) {
+        if ((uintptr_t)object.ptr == old_ptr) frame[i].ptr = new_ptr;
+    }
+    void** escapes = gc_escapes[len(gc_escapes) - 1];
+    if (escapes == NULL) return;
+    for (size_t i = 0; i < len(escapes); i++) {
+        if ((uintptr_t)escapes[i] == old_ptr) escapes[i] = new_ptr;
+    }
+}
+
 #if DEBUG == 1
 #define GC_INFO(...) printf("GC INFO *** " __VA_ARGS__)
 #else
@@ -59,18 +89,14 @@ void* _List_from_array(size_t elem_size, const void* arr, size_t n) {
 
 static void* _List_resize(void* list, size_t new_capacity, bool update_ptr) {
     _ListHeader* head = _List_get_header(list);
+    uintptr_t old_list = (uintptr_t)list;
     _ListHeader* new_head = realloc(head, sizeof(_ListHeader) + head->element_size * new_capacity);
     if (new_head == NULL) return list;  // Fail-safe
     new_head->capacity = new_capacity;
     void* new_list = (void*)&new_head[1];
 
     // if List is being tracked, update the pointer
-    GCItem* frame = gc_pop_frame();
-    if (update_ptr && frame != NULL) {
-        foreach (object, frame) {
-            if (object.ptr == list) frame[i].ptr = new_list;
-        }
-    }
+    if (update_ptr) gc_update_ptr(old_list, new_list);
 
     return new_list;
 }
@@ -151,6 +177,193 @@ void _List_sort(void* list, int (*cmp_fn)(const void*, const void*)) {
     qsort(list, len(list), _List_get_header(list)->element_size, cmp_fn);
 }
 
+static inline bool _is_before(const void* element, const void* value, sort_fn_t cmp_fn, bool upper) {
+    int c = cmp_fn(element, value);
+    return upper ? c <= 0 : c < 0;
+}
+
+// Branchless: the comparison only picks the next base, which compiles to a conditional move
+size_t _List_lower_bound(void* list, const void* value, sort_fn_t cmp_fn, bool upper) {
+    const size_t element_size = _List_get_header(list)->element_size;
+    const char* base = list;
+    size_t n = len(list);
+    if (n == 0) return 0;
+
+    while (n > 1) {
+        size_t half = n / 2;
+        base = _is_before(base + half * element_size, value, cmp_fn, upper)
+                   ? base + half * element_size
+                   : base;
+        n -= half;
+    }
+    return (base - (char*)list) / element_size + _is_before(base, value, cmp_fn, upper);
+}
+
+int _List_bsearch(void* list, const void* value, sort_fn_t cmp_fn) {
+    size_t i = _List_lower_bound(list, value, cmp_fn, false);
+    const size_t element_size = _List_get_header(list)->element_size;
+    if (i < len(list) && cmp_fn((char*)list + i * element_size, value) == 0) return i;
+    return -1;
+}
+
+// In-order walk of the implicit tree (children of k are 2k and 2k + 1, 1-indexed)
+static size_t _eytzinger_fill(char* dst, const char* src, size_t element_size, size_t n, size_t i,
+                              size_t k) {
+    if (k > n) return i;
+    i = _eytzinger_fill(dst, src, element_size, n, i, 2 * k);
+    memcpy(dst + (k - 1) * element_size, src + i * element_size, element_size);
+    return _eytzinger_fill(dst, src, element_size, n, i + 1, 2 * k + 1);
+}
+
+void* _List_eytzinger(void* list) {
+    _ListHeader* head = _List_get_header(list);
+    void* new_list = _List_new(head->element_size, head->length + 1);
+    _eytzinger_fill(new_list, list, head->element_size, head->length, 0, 1);
+    _List_get_header(new_list)->length = head->length;
+    return new_list;
+}
+
+int _List_eytzinger_search(void* list, const void* value, sort_fn_t cmp_fn) {
+    const size_t element_size = _List_get_header(list)->element_size;
+    const char* base = list;
+    const size_t n = len(list);
+
+    size_t k = 1;
+    while (k <= n) {
+        __builtin_prefetch(base + (16 * k - 1) * element_size);  // Four levels down
+        k = 2 * k + (cmp_fn(base + (k - 1) * element_size, value) < 0);
+    }
+    k >>= __builtin_ffsll(~k);  // Undo the right turns taken after the last left one
+
+    if (k == 0 || cmp_fn(base + (k - 1) * element_size, value) != 0) return -1;
+    return k - 1;
+}
+
+void _List_unique(void* list, sort_fn_t cmp_fn) {
+    _ListHeader* head = _List_get_header(list);
+    const size_t element_size = head->element_size;
+    char* base = list;
+    if (head->length < 2) return;
+
+    size_t kept = 1;
+    for (size_t i = 1; i < head->length; i++) {
+        if (cmp_fn(base + (kept - 1) * element_size, base + i * element_size) == 0) continue;
+        if (kept != i) memcpy(base + kept * element_size, base + i * element_size, element_size);
+        kept++;
+    }
+    head->length = kept;
+}
+
+#define _GALLOP_RATIO 8
+
+// First index in [lo, n) that is not before value, probing lo, lo + 1, lo + 3, lo + 7...
+static size_t _gallop(const char* base, size_t lo, size_t n, size_t element_size,
+                      const void* value, sort_fn_t cmp_fn, bool upper) {
+    size_t hi = lo, step = 1;
+    while (hi < n && _is_before(base + hi * element_size, value, cmp_fn, upper)) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > n) hi = n;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (_is_before(base + mid * element_size, value, cmp_fn, upper))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Multiset semantics like C++'s std::merge and std::set_*: equal elements are taken from list1
+void* _List_set_op(void* list1, void* list2, sort_fn_t cmp_fn, _SetOp op) {
+    const size_t element_size = _List_get_header(list1)->element_size;
+    assert(element_size == _List_get_header(list2)->element_size);
+    const char *a = list1, *b = list2;
+    const size_t na = len(list1), nb = len(list2);
+
+    size_t capacity = na + nb;
+    if (op == _SET_INTERSECTION) capacity = na < nb ? na : nb;
+    if (op == _SET_DIFFERENCE) capacity = na;
+    char* result = _List_new(element_size, capacity + 1);
+    char* out = result;
+    size_t i = 0, j = 0;
+
+#define _AT(list, idx) ((list) + (idx) * element_size)
+#define _TAKE(src, count) \
+    (memcpy(out, (src), (count) * element_size), out += (count) * element_size)
+#define _EQUAL(x, y) (cmp_fn((x), (y)) == 0)
+
+    if (nb >= na * _GALLOP_RATIO) {
+        // list1 is much smaller: find where each of its elements lands in list2
+        for (; i < na; i++) {
+            const char* x = _AT(a, i);
+            size_t k = _gallop(b, j, nb, element_size, x, cmp_fn, false);
+            if (op == _SET_MERGE || op == _SET_UNION) _TAKE(_AT(b, j), k - j);
+            j = k;
+            bool found = j < nb && _EQUAL(_AT(b, j), x);
+            if (op == _SET_MERGE || op == _SET_UNION || (op == _SET_INTERSECTION && found) ||
+                (op == _SET_DIFFERENCE && !found))
+                _TAKE(x, 1);
+            if (found && op != _SET_MERGE) j++;
+        }
+    } else if (na >= nb * _GALLOP_RATIO) {
+        // list2 is much smaller: copy whole runs of list1 between its elements
+        for (; j < nb; j++) {
+            const char* y = _AT(b, j);
+            size_t k = _gallop(a, i, na, element_size, y, cmp_fn, op == _SET_MERGE);
+            if (op != _SET_INTERSECTION) _TAKE(_AT(a, i), k - i);
+            i = k;
+            bool found = i < na && _EQUAL(_AT(a, i), y);
+            if (op == _SET_MERGE || (op == _SET_UNION && !found)) _TAKE(y, 1);
+            if (found && (op == _SET_UNION || op == _SET_INTERSECTION)) _TAKE(_AT(a, i), 1);
+            if (found && op != _SET_MERGE) i++;
+        }
+    } else {
+        while (i < na && j < nb) {
+            int c = cmp_fn(_AT(a, i), _AT(b, j));
+            switch (op) {
+                case _SET_MERGE:
+                    if (c <= 0)
+                        _TAKE(_AT(a, i++), 1);
+                    else
+                        _TAKE(_AT(b, j++), 1);
+                    break;
+                case _SET_UNION:
+                    if (c > 0) {
+                        _TAKE(_AT(b, j++), 1);
+                    } else {
+                        _TAKE(_AT(a, i++), 1);
+                        j += c == 0;
+                    }
+                    break;
+                case _SET_INTERSECTION:
+                    if (c == 0) _TAKE(_AT(a, i), 1);
+                    i += c <= 0;
+                    j += c >= 0;
+                    break;
+                case _SET_DIFFERENCE:
+                    if (c < 0) _TAKE(_AT(a, i), 1);
+                    i += c <= 0;
+                    j += c >= 0;
+                    break;
+            }
+        }
+    }
+
+    if (op != _SET_INTERSECTION) _TAKE(_AT(a, i), na - i);
+    if (op == _SET_MERGE || op == _SET_UNION) _TAKE(_AT(b, j), nb - j);
+
+#undef _AT
+#undef _TAKE
+#undef _EQUAL
+
+    _List_get_header(result)->length = (out - result) / element_size;
+    return result;
+}
+
 static char* _get_format_type(const char* _Format) {
     char* format_type = (char*)_Format;
     char* ignore_chars = "%.-1234567890";
@@ -262,8 +475,10 @@ String List_string(void* list, const char* _Format) {
 
 __attribute__((constructor)) static void gc_init(void) {
     gc = _List_new_untracked(sizeof(GCItem*), 10);
+    gc_escapes = _List_new_untracked(sizeof(void**), 10);
     GCItem* frame = _List_new_untracked(sizeof(GCItem), 10);
     List_append(gc, frame);
+    List_append(gc_escapes, (void**)NULL);
 }
 
 __attribute__((destructor)) static void gc_cleanup(void) {
@@ -275,9 +490,11 @@ __attribute__((destructor)) static void gc_cleanup(void) {
         }
         GC_INFO("free(frame=%p);\n", _List_get_header(frame));
         free(_List_get_header(frame));
+        if (gc_escapes[i] != NULL) free(_List_get_header(gc_escapes[i]));
     }
     GC_INFO("free(gc=%p);\n", _List_get_header(gc));
     free(_List_get_header(gc));
+    free(_List_get_header(gc_escapes));
     GC_INFO("Final stats: tracked %zu, untracked %zu, freed %zu.\n", gc_tracked, gc_untracked,
             gc_freed);
 }
@@ -293,7 +510,7 @@ void* gc_track(void* p, free_fn_t free_fn) {
     GCItem* frame = gc_pop_frame();
     if (frame == NULL) return p;
     if (free_fn == NULL) free_fn = free;
-    _List_append_noupdate(frame, ((GCItem){.ptr = p, .free_fn = free_fn}));
+    _List_append_noupdate(frame, ((GCItem){.ptr = p, .free_fn = free_fn, .children_fn = NULL}));
     gc[len(gc) - 1] = frame;  // In case frame gets resized
     GC_INFO("Frame #%zu: tracking %p\n", len(gc), p);
     gc_tracked++;
@@ -302,7 +519,9 @@ void* gc_track(void* p, free_fn_t free_fn) {
 
 void gc_frame(void) {
     GCItem* frame = _List_new_untracked(sizeof(GCItem), 10);
-    List_append(gc, frame);
+    // Not List_append: its resize would look up the frames through the list being resized
+    _List_append_noupdate(gc, frame);
+    _List_append_noupdate(gc_escapes, (void**)NULL);
 }
 
 void* gc_keep(void* p) {
@@ -321,48 +540,128 @@ void* gc_keep(void* p) {
     return p;
 }
 
-void* gc_collect(void* p) {
+void* gc_escape(void* p) {
+    if (p == NULL || len(gc) == 0) return p;
+    void** escapes = gc_escapes[len(gc_escapes) - 1];
+    if (escapes == NULL) escapes = _List_new_untracked(sizeof(void*), 10);
+    _List_append_noupdate(escapes, p);
+    gc_escapes[len(gc_escapes) - 1] = escapes;
+    return p;
+}
+
+void* gc_children(void* p, children_fn_t children_fn) {
     GCItem* frame = gc_pop_frame();
     if (frame == NULL) return p;
 
-    bool found = false;
-    GCItem object_found;
+    // Usually called right after the object is created, so look from the end
+    for (size_t i = len(frame); i-- > 0;) {
+        if (frame[i].ptr != p) continue;
+        frame[i].children_fn = children_fn;
+        break;
+    }
+    return p;
+}
 
+void List_children(void* list, void (*visit)(void*)) {
+    void** items = list;
+    for (size_t i = 0; i < len(items); i++)
+        if (items[i] != NULL) visit(items[i]);
+}
+
+static int gc_ptr_cmp(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t)*(void* const*)a, y = (uintptr_t)*(void* const*)b;
+    return (x > y) - (x < y);
+}
+
+static void gc_visit(void* p) { gc_escape(p); }
+
+// Adds the children of escaping objects to the escapes of the current frame, then sorts them
+static void** gc_close_escapes(GCItem* frame) {
+    GCItem* parents = NULL;
+    foreach (object, frame) {
+        if (object.children_fn == NULL) continue;
+        if (parents == NULL) parents = _List_new_untracked(sizeof(GCItem), 10);
+        _List_append_noupdate(parents, object);
+    }
+
+    if (parents != NULL) {
+        _List_sort(parents, gc_ptr_cmp);
+        // gc_visit appends to the list being walked, so it is read again on every iteration
+        for (size_t k = 0; k < len(gc_escapes[len(gc_escapes) - 1]); k++) {
+            void* p = gc_escapes[len(gc_escapes) - 1][k];
+            int i = _List_bsearch(parents, &p, gc_ptr_cmp);
+            if (i == -1 || parents[i].children_fn == NULL) continue;
+            children_fn_t children_fn = parents[i].children_fn;
+            parents[i].children_fn = NULL;  // Only once, in case of cycles
+            children_fn(p, gc_visit);
+        }
+        List_free(parents);
+    }
+
+    void** escapes = gc_escapes[len(gc_escapes) - 1];
+    _List_sort(escapes, gc_ptr_cmp);
+    return escapes;
+}
+
+static void gc_collect_frame(void) {
+    GCItem* frame = gc_pop_frame();
+    if (frame == NULL) return;
+    void** escapes = gc_escapes[len(gc_escapes) - 1];
+    if (escapes != NULL) escapes = gc_close_escapes(frame);
+
+    // Free what does not escape and pack the survivors at the front of the frame
+    size_t kept = 0;
     foreach (object, frame) {
-        if (p != NULL && object.ptr == p) {
-            found = true;
-            object_found = object;
+        if (escapes != NULL && _List_bsearch(escapes, &object.ptr, gc_ptr_cmp) != -1) {
+            frame[kept++] = object;
             continue;
         }
         GC_INFO("collected: free(object=%p);\n", object.ptr);
         object.free_fn(object.ptr);
         gc_freed++;
     }
-    GC_INFO("free(frame=%p);\n", _List_get_header(frame));
-    free(_List_get_header(frame));
+    if (escapes != NULL) free(_List_get_header(escapes));
     List_pop(gc, NULL);
-
-    if (found) {
-        GCItem* frame = gc_pop_frame();
-        if (frame != NULL) {
-            _List_append_noupdate(frame, object_found);
-            gc[len(gc) - 1] = frame;  // In case frame gets resized
+    List_pop(gc_escapes, NULL);
+
+    GCItem* parent = gc_pop_frame();
+    if (parent != NULL && kept > 0) {
+        _ListHeader* head = _List_get_header(parent);
+        if (head->length + kept >= head->capacity) {
+            size_t new_capacity = head->length + kept >= 2 * head->capacity
+                                      ? head->length + kept + 1
+                                      : 2 * head->capacity;
+            parent = _List_resize(parent, new_capacity, false);
+            head = _List_get_header(parent);
+            gc[len(gc) - 1] = parent;
         }
+        memcpy(parent + head->length, frame, kept * sizeof(GCItem));
+        head->length += kept;
     }
 
+    GC_INFO("free(frame=%p);\n", _List_get_header(frame));
+    free(_List_get_header(frame));
+}
+
+void* gc_collect(void* p) {
+    gc_escape(p);
+    gc_collect_frame();
     return p;
 }
 
+void gc_collect_many(void** ptrs, size_t n) {
+    for (size_t i = 0; i < n; i++) gc_escape(ptrs[i]);
+    gc_collect_frame();
+}
+
 void* gc_calloc(size_t count, size_t size) { return gc_track(calloc(count, size), free); }
 
 void* gc_malloc(size_t size) { return gc_track(malloc(size), free); }
 
 void* gc_realloc(void* ptr, size_t size) {
+    uintptr_t old_ptr = (uintptr_t)ptr;
     void* new_ptr = realloc(ptr, size);
-    GCItem* frame = gc_pop_frame();
-    foreach (object, frame) {
-        if (object.ptr == ptr) frame[i].ptr = new_ptr;
-    }
+    gc_update_ptr(old_ptr, new_ptr);
     return new_ptr;
 }
 
@@ -520,4 +819,1121 @@ String String_strip(String s, char* characters) {
     while (end - 1 >= start && String_contains(characters, s[end - 1])) end--;
 
     return String_slice(s, start, end, 1);
-}
\ No newline at end of file
+}
+// Eight ASCII digits at once (SWAR), see Lemire's "Faster integer parsing"
+static inline uint64_t _load_u64_le(const char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline bool _is_eight_digits(uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0) | (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ==
+           0x3333333333333333;
+}
+
+static inline uint32_t _parse_eight_digits(uint64_t v) {
+    v -= 0x3030303030303030;
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) +
+         (((v >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >>
+        32;
+    return (uint32_t)v;
+}
+
+static inline bool _isdigit_c(char c) { return (unsigned char)(c - '0') < 10; }
+
+// Number of leading ASCII digits in a word loaded with _load_u64_le (8 if all are digits)
+static inline int _digit_count(uint64_t v) {
+    uint64_t x = v ^ 0x3030303030303030;  // Digits become 0..9, everything else is >= 10
+    uint64_t non_digit = (x | ((x & 0x7F7F7F7F7F7F7F7F) + 0x7676767676767676)) & 0x8080808080808080;
+    return non_digit ? __builtin_ctzll(non_digit) / 8 : 8;
+}
+
+// Value of the first k (1 to 8) digits of a word: they are moved to the top, padded with '0'
+static inline uint32_t _parse_digits(uint64_t v, int k) {
+    if (k < 8) v = (v << (8 * (8 - k))) | (0x3030303030303030ULL >> (8 * k));
+    return _parse_eight_digits(v);
+}
+
+static const uint64_t _pow10_u64[] = {1,      10,      100,      1000,     10000,
+                                      100000, 1000000, 10000000, 100000000};
+
+const char* String_to_i64(const char* first, const char* last, int64_t* value) {
+    const char* p = first;
+    bool negative = p < last && *p == '-';
+    if (p < last && (*p == '-' || *p == '+')) p++;
+
+    const char* digits = p;
+    uint64_t n = 0;
+    while (last - p >= 8) {
+        uint64_t chunk = _load_u64_le(p);
+        int k = _digit_count(chunk);
+        if (k == 0) break;
+        if (__builtin_mul_overflow(n, _pow10_u64[k], &n) ||
+            __builtin_add_overflow(n, _parse_digits(chunk, k), &n))
+            return NULL;
+        p += k;
+        if (k < 8) break;
+    }
+    while (p < last && _isdigit_c(*p)) {
+        if (__builtin_mul_overflow(n, 10, &n) || __builtin_add_overflow(n, *p - '0', &n))
+            return NULL;
+        p++;
+    }
+    if (p == digits) return NULL;
+
+    if (n > (uint64_t)INT64_MAX + negative) return NULL;
+    *value = negative ? (int64_t)(0 - n) : (int64_t)n;
+    return p;
+}
+
+static const double _pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Slow path: strtod on a copy where '.' is swapped for the current locale's decimal point
+static double _strtod_c_locale(const char* first, size_t n) {
+    const char* point = localeconv()->decimal_point;
+    size_t len_point = strlen(point);
+    char stack_buf[128];
+    char* buf = n * len_point + 1 <= sizeof(stack_buf) ? stack_buf : malloc(n * len_point + 1);
+    char* q = buf;
+    for (size_t i = 0; i < n; i++) {
+        if (first[i] == '.') {
+            memcpy(q, point, len_point);
+            q += len_point;
+        } else {
+            *q++ = first[i];
+        }
+    }
+    *q = 0;
+    double value = strtod(buf, NULL);
+    if (buf != stack_buf) free(buf);
+    return value;
+}
+
+static bool _match_nocase(const char* p, const char* last, const char* word) {
+    size_t n = strlen(word);
+    if ((size_t)(last - p) < n) return false;
+    for (size_t i = 0; i < n; i++)
+        if ((p[i] | 0x20) != word[i]) return false;
+    return true;
+}
+
+const char* String_to_f64(const char* first, const char* last, double* value) {
+    const char* p = first;
+    bool negative = p < last && *p == '-';
+    if (p < last && (*p == '-' || *p == '+')) p++;
+
+    if (_match_nocase(p, last, "inf")) {
+        p += _match_nocase(p, last, "infinity") ? 8 : 3;
+        *value = negative ? -__builtin_inf() : __builtin_inf();
+        return p;
+    }
+    if (_match_nocase(p, last, "nan")) {
+        *value = negative ? -__builtin_nan("") : __builtin_nan("");
+        return p + 3;
+    }
+
+    // Up to 19 significant digits fit in the mantissa, further ones only shift the exponent
+    uint64_t mantissa = 0;
+    int64_t exponent = 0;
+    int significant = 0;
+    bool truncated = false, any_digit = false;
+
+    while (p < last && *p == '0') p++, any_digit = true;
+    while (last - p >= 8 && significant <= 11) {
+        uint64_t chunk = _load_u64_le(p);
+        if (!_is_eight_digits(chunk)) break;
+        mantissa = mantissa * 100000000 + _parse_eight_digits(chunk);
+        significant += 8;
+        p += 8;
+        any_digit = true;
+    }
+    for (; p < last && _isdigit_c(*p); p++, any_digit = true) {
+        if (significant < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) significant++;
+        } else {
+            exponent++;
+            truncated |= *p != '0';
+        }
+    }
+    if (p < last && *p == '.') {
+        p++;
+        if (mantissa == 0)
+            for (; p < last && *p == '0'; p++) exponent--, any_digit = true;
+        while (last - p >= 8 && significant <= 11) {
+            uint64_t chunk = _load_u64_le(p);
+            if (!_is_eight_digits(chunk)) break;
+            mantissa = mantissa * 100000000 + _parse_eight_digits(chunk);
+            significant += 8;
+            exponent -= 8;
+            p += 8;
+            any_digit = true;
+        }
+        for (; p < last && _isdigit_c(*p); p++, any_digit = true) {
+            if (significant < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) significant++;
+                exponent--;
+            } else {
+                truncated |= *p != '0';
+            }
+        }
+    }
+    if (!any_digit) return NULL;
+
+    if (p < last && (*p | 0x20) == 'e') {
+        const char* q = p + 1;
+        bool exp_negative = q < last && *q == '-';
+        if (q < last && (*q == '-' || *q == '+')) q++;
+        if (q < last && _isdigit_c(*q)) {
+            int64_t e = 0;
+            for (; q < last && _isdigit_c(*q); q++)
+                if (e < 100000) e = e * 10 + (*q - '0');
+            exponent += exp_negative ? -e : e;
+            p = q;
+        }
+    }
+
+    // Clinger's fast path: both operands are exact doubles, so one rounding gives the answer
+    if (!truncated && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        double d = (double)mantissa;
+        d = exponent < 0 ? d / _pow10[-exponent] : d * _pow10[exponent];
+        *value = negative ? -d : d;
+        return p;
+    }
+
+    *value = _strtod_c_locale(first, p - first);
+    return p;
+}
+
+static const char* _skip_blanks(const char* p, const char* last, char sep) {
+    while (p < last && (*p == ' ' || *p == '\t' || *p == '\r') && *p != sep) p++;
+    return p;
+}
+
+// Moves past the separator following a field, or returns NULL if something else is there
+static const char* _end_field(const char* p, const char* last, char sep) {
+    p = _skip_blanks(p, last, sep);
+    if (p < last && *p != sep && *p != '\n') return NULL;
+    return p < last ? p + 1 : p;
+}
+
+// Capacity for the whole input, extrapolated from what the first `done` items used
+static size_t _estimate_count(size_t done, size_t used_bytes, size_t total_bytes) {
+    if (used_bytes == 0) return done + 10;
+    return (size_t)((double)done * total_bytes / used_bytes * 1.1) + 10;
+}
+
+#define _ESTIMATE_AFTER 64
+
+// Reads an int straight from p, for the common case of plain digits. Needs 32 readable bytes.
+// Returns NULL when the general path has to decide (no digits, more than 16, out of range).
+static inline const char* _fast_int(const char* p, int* value) {
+    bool negative = *p == '-';
+    p += negative;
+
+    uint64_t w = _load_u64_le(p);
+    int k = _digit_count(w);
+    if (k == 0) return NULL;
+    uint64_t n = _parse_digits(w, k);
+    p += k;
+    if (k == 8) {
+        w = _load_u64_le(p);
+        k = _digit_count(w);
+        if (k == 8) return NULL;
+        if (k > 0) {
+            n = n * _pow10_u64[k] + _parse_digits(w, k);
+            p += k;
+        }
+    }
+
+    if (n > (uint64_t)INT32_MAX + negative) return NULL;
+    *value = negative ? (int)(0 - n) : (int)n;
+    return p;
+}
+
+// Returns NULL on a token that is not a number (or not an int), or on an empty field
+static void* _List_parse_numbers(String text, char sep, bool doubles) {
+    size_t length = len(text);
+    const char *p = text, *last = text + length;
+    size_t element_size = doubles ? sizeof(double) : sizeof(int);
+    void* list = _List_new(element_size, length < 1024 ? 16 : 256);
+    _ListHeader* head = _List_get_header(list);
+    bool after_sep = false;  // A field must follow, even on a blank line or at the end
+
+    while (true) {
+        const char* end;
+        int fast_value;
+        if (!doubles && last - p >= 32 && (end = _fast_int(p, &fast_value)) != NULL &&
+            (*end == sep || *end == '\n')) {
+            ((int*)list)[head->length++] = fast_value;
+            p = end + 1;
+        } else {
+            p = _skip_blanks(p, last, sep);
+            if (p == last || *p == '\n') {
+                if (after_sep) return NULL;
+                if (p == last) break;
+                p++;  // blank line
+                continue;
+            }
+
+            if (doubles) {
+                double value;
+                end = String_to_f64(p, last, &value);
+                if (end == NULL) return NULL;
+                ((double*)list)[head->length++] = value;
+            } else {
+                int64_t value;
+                end = String_to_i64(p, last, &value);
+                if (end == NULL || value < INT32_MIN || value > INT32_MAX) return NULL;
+                ((int*)list)[head->length++] = (int)value;
+            }
+            p = _end_field(end, last, sep);
+            if (p == NULL) return NULL;
+        }
+        after_sep = p[-1] == sep && sep != '\n';
+
+        if (head->length == _ESTIMATE_AFTER) {
+            size_t estimate = _estimate_count(head->length, p - text, length);
+            if (estimate > head->capacity) list = List_resize(list, estimate);
+        } else if (head->length >= head->capacity) {
+            list = List_resize(list, head->capacity * 2);
+        }
+        head = _List_get_header(list);
+    }
+
+    return list;
+}
+
+int* List_parse_ints(String text, char sep) { return _List_parse_numbers(text, sep, false); }
+
+double* List_parse_doubles(String text, char sep) { return _List_parse_numbers(text, sep, true); }
+
+static String _String_from_range(const char* p, size_t n) {
+    String s = _List_new(sizeof(char), n + 1);
+    memcpy(s, p, n);
+    s[n] = 0;
+    _List_get_header(s)->length = n;
+    return s;
+}
+
+// End of the row starting at p (its '\n' or last), skipping newlines inside quoted fields
+static const char* _CSV_row_end(const char* p, const char* last) {
+    bool quoted = false;
+    for (; p < last; p++) {
+        if (*p == '"') quoted = !quoted;  // A doubled quote flips twice
+        if (*p == '\n' && !quoted) break;
+    }
+    return p;
+}
+
+// Position of the quote closing the field that opens at p, where "" stands for one quote.
+// NULL if the quote is never closed.
+static const char* _CSV_closing_quote(const char* p, const char* last) {
+    for (p++; p < last; p++) {
+        if (*p != '"') continue;
+        if (p + 1 < last && p[1] == '"')
+            p++;
+        else
+            return p;
+    }
+    return NULL;
+}
+
+static String _CSV_unquote(const char* open, const char* close) {
+    String s = _String_from_range(open + 1, close - open - 1);
+    char* out = s;
+    for (const char* q = open + 1; q < close; q++) {
+        *out++ = *q;
+        if (*q == '"') q++;  // Keep one quote of each pair
+    }
+    *out = 0;
+    _List_get_header(s)->length = out - s;
+    return s;
+}
+
+void** CSV_columns(String text, char sep, const char* types, bool header) {
+    size_t length = len(text), columns = strlen(types);
+    const char *p = text, *last = text + length;
+    assert(columns > 0);
+
+    if (header) {
+        p = _CSV_row_end(p, last);
+        if (p < last) p++;
+    }
+    const char* data = p;
+
+    void** cols = List_new(void*);
+    for (size_t c = 0; c < columns; c++) {
+        size_t element_size = 0;
+        switch (types[c]) {
+            case 'd': element_size = sizeof(int); break;
+            case 'f': element_size = sizeof(double); break;
+            case 's': element_size = sizeof(String); break;
+            default: assert(false && "CSV_columns: type must be one of 'd', 'f' or 's'");
+        }
+        void* col = _List_new(element_size, length < 1024 ? 16 : 256);
+        List_append(cols, col);
+    }
+
+    size_t rows = 0;
+    while (p < last) {
+        const char* q = _skip_blanks(p, last, sep);
+        if (q == last) break;
+        if (*q == '\n') {  // blank line
+            p = q + 1;
+            continue;
+        }
+
+        for (size_t c = 0; c < columns; c++) {
+            const char* end;
+            const char* field = types[c] == 's' ? p : _skip_blanks(p, last, sep);
+            const char* close = NULL;
+            if (field < last && *field == '"') {
+                close = _CSV_closing_quote(field, last);
+                if (close == NULL) return NULL;
+            }
+            // Numbers are read between the quotes, if any, and may be empty there too
+            const char* first = close ? _skip_blanks(field + 1, close, sep) : field;
+            const char* stop = close ? close : last;
+            bool empty = first == stop || (!close && (*first == sep || *first == '\n'));
+
+            if (types[c] == 's') {
+                String value;
+                if (close) {
+                    value = _CSV_unquote(field, close);
+                    end = close + 1;
+                } else {
+                    end = field;
+                    while (end < last && *end != sep && *end != '\n') end++;
+                    const char* field_end = end;
+                    if (field_end > field && field_end[-1] == '\r') field_end--;
+                    value = _String_from_range(field, field_end - field);
+                }
+                String* col = cols[c];
+                List_append(col, value);
+                cols[c] = col;
+            } else if (types[c] == 'f') {
+                double value = __builtin_nan("");
+                end = empty ? first : String_to_f64(first, stop, &value);
+                if (end == NULL) return NULL;
+                double* col = cols[c];
+                List_append(col, value);
+                cols[c] = col;
+            } else {
+                int value = 0;
+                end = first;
+                if (!empty && (close != NULL || last - first < 32 ||
+                               (end = _fast_int(first, &value)) == NULL)) {
+                    int64_t wide;
+                    end = String_to_i64(first, stop, &wide);
+                    if (end == NULL || wide < INT32_MIN || wide > INT32_MAX) return NULL;
+                    value = (int)wide;
+                }
+                int* col = cols[c];
+                List_append(col, value);
+                cols[c] = col;
+            }
+
+            if (close && types[c] != 's') {
+                if (_skip_blanks(end, close, sep) != close) return NULL;
+                end = close + 1;
+            }
+            end = _skip_blanks(end, last, sep);
+            if (c + 1 < columns ? end == last || *end != sep : end != last && *end != '\n')
+                return NULL;  // Missing or extra fields, or text after a number
+            p = end < last ? end + 1 : end;
+        }
+
+        // Reserve every column for the whole input once a few rows show the average row length
+        if (++rows == _ESTIMATE_AFTER) {
+            size_t estimate = _estimate_count(rows, p - data, last - data);
+            for (size_t c = 0; c < columns; c++)
+                if (estimate > _List_get_header(cols[c])->capacity)
+                    cols[c] = List_resize(cols[c], estimate);
+        }
+    }
+
+    return cols;
+}
+
+static void _lines_push(Line** lines, const char* data, size_t size, size_t start, size_t end) {
+    if (end > start && data[end - 1] == '\r') end--;
+    Line* list = *lines;
+    _ListHeader* head = _List_get_header(list);
+    list[head->length++] = (Line){.offset = start, .length = end - start};
+
+    if (head->length == _ESTIMATE_AFTER) {
+        size_t estimate = _estimate_count(head->length, end + 1, size);
+        if (estimate > head->capacity) list = _List_resize(list, estimate, false);
+    } else if (head->length >= head->capacity) {
+        list = _List_resize(list, head->capacity * 2, false);
+    }
+    *lines = list;
+}
+
+// Finds every '\n' 16 bytes at a time, handling all matches of a block from one bitmask
+static Line* _find_lines(const char* data, size_t size) {
+    Line* lines = _List_new_untracked(sizeof(Line), 16);
+    size_t start = 0, i = 0;
+
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        while (mask) {
+            size_t end = i + __builtin_ctz(mask);
+            _lines_push(&lines, data, size, start, end);
+            start = end + 1;
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t newline = vdupq_n_u8('\n');
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8((const uint8_t*)data + i), newline);
+        // Narrow to 4 bits per byte since NEON has no movemask
+        uint64_t mask =
+            vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (mask) {
+            int bit = __builtin_ctzll(mask);
+            size_t end = i + bit / 4;
+            _lines_push(&lines, data, size, start, end);
+            start = end + 1;
+            mask &= ~(0xFULL << bit);
+        }
+    }
+#endif
+
+    const char* nl;
+    while (i < size && (nl = memchr(data + i, '\n', size - i)) != NULL) {
+        size_t end = nl - data;
+        _lines_push(&lines, data, size, start, end);
+        start = i = end + 1;
+    }
+    if (start < size) _lines_push(&lines, data, size, start, size);
+
+    return lines;
+}
+
+File* File_lines(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    File* file = malloc(sizeof(File));
+    file->size = st.st_size;
+    file->data = NULL;
+    if (file->size > 0) {
+        void* data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            free(file);
+            return NULL;
+        }
+        file->data = data;
+    }
+    close(fd);  // The mapping stays valid
+
+    if (file->data) madvise((void*)file->data, file->size, MADV_SEQUENTIAL);
+    file->lines = _find_lines(file->data, file->size);
+    if (file->data) madvise((void*)file->data, file->size, MADV_NORMAL);
+
+    return gc_track(file, (free_fn_t)File_free);
+}
+
+String File_line(File* file, int i) {
+    Line line = List_at(file->lines, i);
+    return _String_from_range(file->data + line.offset, line.length);
+}
+
+void File_free(File* file) {
+    if (file->data) munmap((void*)file->data, file->size);
+    List_free(file->lines);
+    free(file);
+}
+
+#define _FILE_CHUNK (1 << 20)
+
+FileLineIter* File_line_iter(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    FileLineIter* it = malloc(sizeof(FileLineIter));
+    *it = (FileLineIter){.fd = fd, .buffer = malloc(_FILE_CHUNK), .capacity = _FILE_CHUNK};
+    return gc_track(it, (free_fn_t)File_line_iter_free);
+}
+
+bool File_next_line(FileLineIter* it, const char** line, size_t* length) {
+    while (true) {
+        char* begin = it->buffer + it->start;
+        char* nl = memchr(begin, '\n', it->end - it->start);
+        char* end = nl ? nl : it->buffer + it->end;
+
+        if (nl || (it->eof && it->start < it->end)) {
+            it->start = nl ? nl + 1 - it->buffer : it->end;
+            if (end > begin && end[-1] == '\r') end--;
+            *line = begin;
+            *length = end - begin;
+            return true;
+        }
+        if (it->eof) return false;
+
+        // Carry the partial line over to the front, growing the buffer if it fills it entirely
+        size_t partial = it->end - it->start;
+        memmove(it->buffer, begin, partial);
+        it->start = 0;
+        it->end = partial;
+        if (partial == it->capacity) {
+            it->capacity *= 2;
+            it->buffer = realloc(it->buffer, it->capacity);
+        }
+
+        ssize_t n = read(it->fd, it->buffer + it->end, it->capacity - it->end);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {  // Drop the partial line rather than return it as if it were the last one
+            it->error = it->eof = true;
+            it->start = it->end;
+            return false;
+        }
+        if (n == 0)
+            it->eof = true;
+        else
+            it->end += n;
+    }
+}
+
+void File_line_iter_free(FileLineIter* it) {
+    close(it->fd);
+    free(it->buffer);
+    free(it);
+}
+
+// Bits past len(bits) are always kept at zero, so whole words can be counted and scanned
+static inline size_t _BitList_words(size_t length) { return (length + 63) / 64; }
+
+BitList BitList_new(size_t length) {
+    size_t capacity = _BitList_words(length) + 1;
+    BitList bits = _List_new(sizeof(uint64_t), capacity);
+    memset(bits, 0, capacity * sizeof(uint64_t));
+    _List_get_header(bits)->length = length;
+    return bits;
+}
+
+BitList _BitList_append(BitList bits, bool value) {
+    _ListHeader* head = _List_get_header(bits);
+    size_t i = head->length;
+    if (i / 64 >= head->capacity) {
+        size_t old_capacity = head->capacity;
+        bits = List_resize(bits, old_capacity * 2);
+        memset(bits + old_capacity, 0, old_capacity * sizeof(uint64_t));
+        head = _List_get_header(bits);
+    }
+    bits[i / 64] |= (uint64_t)value << (i % 64);
+    head->length++;
+    return bits;
+}
+
+bool BitList_get(BitList bits, size_t i) {
+    assert(i < len(bits));
+    return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+void BitList_set(BitList bits, size_t i, bool value) {
+    assert(i < len(bits));
+    uint64_t mask = 1ULL << (i % 64);
+    bits[i / 64] = (bits[i / 64] & ~mask) | (-(uint64_t)value & mask);
+}
+
+size_t BitList_count(BitList bits) {
+    size_t count = 0, words = _BitList_words(len(bits));
+    for (size_t w = 0; w < words; w++) count += __builtin_popcountll(bits[w]);
+    return count;
+}
+
+size_t BitList_find_next_set(BitList bits, size_t from) {
+    size_t length = len(bits), words = _BitList_words(length);
+    if (from >= length) return length;
+
+    size_t w = from / 64;
+    uint64_t word = bits[w] & (~0ULL << (from % 64));
+    while (word == 0) {
+        if (++w >= words) return length;
+        word = bits[w];
+    }
+    return w * 64 + __builtin_ctzll(word);
+}
+
+// Plain word loops, which compilers turn into SIMD on their own
+#define _BITLIST_OP(name, op)                                  \
+    void name(BitList bits, BitList other) {                   \
+        assert(len(bits) == len(other));                       \
+        size_t words = _BitList_words(len(bits));              \
+        for (size_t w = 0; w < words; w++) bits[w] op other[w]; \
+    }
+
+_BITLIST_OP(BitList_and, &=)
+_BITLIST_OP(BitList_or, |=)
+_BITLIST_OP(BitList_xor, ^=)
+
+void BitList_not(BitList bits) {
+    size_t length = len(bits), words = _BitList_words(length);
+    for (size_t w = 0; w < words; w++) bits[w] = ~bits[w];
+    if (length % 64) bits[words - 1] &= (1ULL << (length % 64)) - 1;
+}
+
+BitList BitList_copy(BitList bits) {
+    _ListHeader* head = _List_get_header(bits);
+    BitList new_bits = _List_new(sizeof(uint64_t), head->capacity);
+    memcpy(new_bits, bits, head->capacity * sizeof(uint64_t));
+    _List_get_header(new_bits)->length = head->length;
+    return new_bits;
+}
+
+BitList BitList_from_bools(bool* list) {
+    size_t length = len(list);
+    BitList bits = BitList_new(length);
+    const char* bytes = (const char*)list;
+
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        // Each byte is 0 or 1: the multiply gathers byte k into bit k of the top byte
+        uint64_t packed = (_load_u64_le(bytes + i) * 0x0102040810204080ULL) >> 56;
+        bits[i / 64] |= packed << (i % 64);
+    }
+    for (; i < length; i++) bits[i / 64] |= (uint64_t)list[i] << (i % 64);
+    return bits;
+}
+
+bool* BitList_to_bools(BitList bits) {
+    size_t length = len(bits);
+    bool* list = _List_new(sizeof(bool), length + 1);
+    for (size_t i = 0; i < length; i++) list[i] = (bits[i / 64] >> (i % 64)) & 1;
+    _List_get_header(list)->length = length;
+    return list;
+}
+
+#define _HIGH_BITS 0x8080808080808080ULL
+
+// Length of the leading run of ASCII bytes, checked 16 bytes at a time with SIMD, else 32 then 8
+static size_t _ascii_prefix(const char* s, size_t n) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16) {
+        unsigned mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(s + i)));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 16 <= n; i += 16)
+        if (vmaxvq_u8(vld1q_u8((const uint8_t*)s + i)) >= 0x80) break;
+#else
+    for (; i + 32 <= n; i += 32) {
+        uint64_t w = _load_u64_le(s + i) | _load_u64_le(s + i + 8) | _load_u64_le(s + i + 16) |
+                     _load_u64_le(s + i + 24);
+        if (w & _HIGH_BITS) break;
+    }
+#endif
+    for (; i + 8 <= n; i += 8)
+        if (_load_u64_le(s + i) & _HIGH_BITS) break;
+    while (i < n && (unsigned char)s[i] < 0x80) i++;
+    return i;
+}
+
+// Decodes one non-ASCII character following table 3-7 of the Unicode standard.
+// Returns its length in bytes, or 0 if the sequence is not well-formed.
+static size_t _utf8_decode(const unsigned char* p, const unsigned char* last, uint32_t* cp) {
+    unsigned char c = p[0];
+    size_t need;
+    unsigned char lo = 0x80, hi = 0xBF;  // Allowed range of the second byte
+
+    if (c >= 0xC2 && c <= 0xDF) {
+        need = 1;
+        *cp = c & 0x1F;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        need = 2;
+        *cp = c & 0x0F;
+        if (c == 0xE0) lo = 0xA0;
+        if (c == 0xED) hi = 0x9F;  // No surrogates
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        need = 3;
+        *cp = c & 0x07;
+        if (c == 0xF0) lo = 0x90;
+        if (c == 0xF4) hi = 0x8F;  // Nothing above U+10FFFF
+    } else {
+        return 0;
+    }
+
+    if ((size_t)(last - p) <= need) return 0;
+    if (p[1] < lo || p[1] > hi) return 0;
+    for (size_t k = 1; k <= need; k++) {
+        if ((p[k] & 0xC0) != 0x80) return 0;
+        *cp = (*cp << 6) | (p[k] & 0x3F);
+    }
+    return need + 1;
+}
+
+static size_t _utf8_encode(uint32_t cp, char* out) {
+    if (cp < 0x80) {
+        out[0] = cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = 0xC0 | (cp >> 6);
+        out[1] = 0x80 | (cp & 0x3F);
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = 0xE0 | (cp >> 12);
+        out[1] = 0x80 | ((cp >> 6) & 0x3F);
+        out[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | (cp >> 18);
+    out[1] = 0x80 | ((cp >> 12) & 0x3F);
+    out[2] = 0x80 | ((cp >> 6) & 0x3F);
+    out[3] = 0x80 | (cp & 0x3F);
+    return 4;
+}
+
+// x86 builds always compile the SSSE3 version and String_utf8_valid checks the CPU before using it
+#if defined(__SSE2__)
+#define _UTF8_SIMD __attribute__((target("ssse3")))
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define _UTF8_SIMD
+#endif
+
+#if defined(_UTF8_SIMD)
+// Validation 16 bytes at a time with three nibble lookups (Keiser and Lemire, "Validating UTF-8 In
+// Less Than One Instruction Per Byte"). Each table gives the errors a byte could take part in:
+// for the high and low nibble of the previous byte, and for the high nibble of the current one.
+// A bit set in all three is an error, except that two continuations in a row are expected where
+// a 3 or 4-byte character started 2 or 3 bytes before.
+#define _UTF8_TOO_SHORT 0x01  // Lead byte (or ASCII) where a continuation is needed
+#define _UTF8_TOO_LONG 0x02   // Continuation after ASCII
+#define _UTF8_OVERLONG_3 0x04
+#define _UTF8_TOO_LARGE 0x08
+#define _UTF8_SURROGATE 0x10
+#define _UTF8_OVERLONG_2 0x20
+#define _UTF8_TOO_LARGE_1000 0x40
+#define _UTF8_OVERLONG_4 0x40
+#define _UTF8_TWO_CONTS 0x80
+#define _UTF8_CARRY (_UTF8_TOO_SHORT | _UTF8_TOO_LONG | _UTF8_TWO_CONTS)
+
+static const uint8_t _utf8_byte_1_high[16] = {
+    _UTF8_TOO_LONG, _UTF8_TOO_LONG, _UTF8_TOO_LONG, _UTF8_TOO_LONG,
+    _UTF8_TOO_LONG, _UTF8_TOO_LONG, _UTF8_TOO_LONG, _UTF8_TOO_LONG,  // 0xxxxxxx
+    _UTF8_TWO_CONTS, _UTF8_TWO_CONTS, _UTF8_TWO_CONTS, _UTF8_TWO_CONTS,  // 10xxxxxx
+    _UTF8_TOO_SHORT | _UTF8_OVERLONG_2,  // 1100xxxx
+    _UTF8_TOO_SHORT,  // 1101xxxx
+    _UTF8_TOO_SHORT | _UTF8_OVERLONG_3 | _UTF8_SURROGATE,  // 1110xxxx
+    _UTF8_TOO_SHORT | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000 | _UTF8_OVERLONG_4,  // 1111xxxx
+};
+
+static const uint8_t _utf8_byte_1_low[16] = {
+    _UTF8_CARRY | _UTF8_OVERLONG_3 | _UTF8_OVERLONG_2 | _UTF8_OVERLONG_4,  // xxxx0000
+    _UTF8_CARRY | _UTF8_OVERLONG_2,  // xxxx0001
+    _UTF8_CARRY,
+    _UTF8_CARRY,
+    _UTF8_CARRY | _UTF8_TOO_LARGE,  // xxxx0100
+    _UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+    _UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+    _UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+    _UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+    _UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+    _UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+    _UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+    _UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+    _UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000 | _UTF8_SURROGATE,  // xxxx1101
+    _UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+    _UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+};
+
+static const uint8_t _utf8_byte_2_high[16] = {
+    _UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT,
+    _UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT,  // 0xxxxxxx
+    _UTF8_TOO_LONG | _UTF8_OVERLONG_2 | _UTF8_TWO_CONTS | _UTF8_OVERLONG_3 |
+        _UTF8_TOO_LARGE_1000 | _UTF8_OVERLONG_4,  // 1000xxxx
+    _UTF8_TOO_LONG | _UTF8_OVERLONG_2 | _UTF8_TWO_CONTS | _UTF8_OVERLONG_3 |
+        _UTF8_TOO_LARGE,  // 1001xxxx
+    _UTF8_TOO_LONG | _UTF8_OVERLONG_2 | _UTF8_TWO_CONTS | _UTF8_SURROGATE | _UTF8_TOO_LARGE,
+    _UTF8_TOO_LONG | _UTF8_OVERLONG_2 | _UTF8_TWO_CONTS | _UTF8_SURROGATE | _UTF8_TOO_LARGE,
+    _UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT,  // 11xxxxxx
+};
+
+// A lead byte in the last 1, 2 or 3 positions leaves its character for the next block
+static const uint8_t _utf8_incomplete_max[16] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF,
+};
+
+#if defined(__SSE2__)
+typedef __m128i _u8x16;
+#define _u8x16_load(p) _mm_loadu_si128((const __m128i*)(p))
+#define _u8x16_splat(c) _mm_set1_epi8((char)(c))
+#define _u8x16_lookup(table, v) _mm_shuffle_epi8(table, v)
+#define _u8x16_high_nibble(v) _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F))
+#define _u8x16_low_nibble(v) _mm_and_si128(v, _mm_set1_epi8(0x0F))
+#define _u8x16_and _mm_and_si128
+#define _u8x16_or _mm_or_si128
+#define _u8x16_xor _mm_xor_si128
+#define _u8x16_subs _mm_subs_epu8
+#define _u8x16_prev(in, prev, n) _mm_alignr_epi8(in, prev, 16 - (n))  // Bytes shifted in by n
+#define _u8x16_has_high_bit(v) (_mm_movemask_epi8(v) != 0)
+#define _u8x16_any(v) (_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) != 0xFFFF)
+#else
+typedef uint8x16_t _u8x16;
+#define _u8x16_load(p) vld1q_u8((const uint8_t*)(p))
+#define _u8x16_splat(c) vdupq_n_u8(c)
+#define _u8x16_lookup(table, v) vqtbl1q_u8(table, v)
+#define _u8x16_high_nibble(v) vshrq_n_u8(v, 4)
+#define _u8x16_low_nibble(v) vandq_u8(v, vdupq_n_u8(0x0F))
+#define _u8x16_and vandq_u8
+#define _u8x16_or vorrq_u8
+#define _u8x16_xor veorq_u8
+#define _u8x16_subs vqsubq_u8
+#define _u8x16_prev(in, prev, n) vextq_u8(prev, in, 16 - (n))
+#define _u8x16_has_high_bit(v) (vmaxvq_u8(v) >= 0x80)
+#define _u8x16_any(v) (vmaxvq_u8(v) != 0)
+#endif
+
+// Error bits of the block `in`, given the block before it
+_UTF8_SIMD static inline _u8x16 _utf8_check_block(_u8x16 in, _u8x16 prev, const _u8x16 tables[3]) {
+    _u8x16 prev1 = _u8x16_prev(in, prev, 1);
+    _u8x16 special = _u8x16_and(
+        _u8x16_and(_u8x16_lookup(tables[0], _u8x16_high_nibble(prev1)),
+                   _u8x16_lookup(tables[1], _u8x16_low_nibble(prev1))),
+        _u8x16_lookup(tables[2], _u8x16_high_nibble(in)));
+
+    // High bit where 2 or 3 bytes back is a lead of 3 or 4 bytes: a continuation must be here
+    _u8x16 must23 = _u8x16_or(_u8x16_subs(_u8x16_prev(in, prev, 2), _u8x16_splat(0xE0 - 0x80)),
+                              _u8x16_subs(_u8x16_prev(in, prev, 3), _u8x16_splat(0xF0 - 0x80)));
+    return _u8x16_xor(_u8x16_and(must23, _u8x16_splat(0x80)), special);
+}
+
+_UTF8_SIMD static bool _utf8_valid_simd(const char* s, size_t n) {
+    const _u8x16 tables[3] = {_u8x16_load(_utf8_byte_1_high), _u8x16_load(_utf8_byte_1_low),
+                              _u8x16_load(_utf8_byte_2_high)};
+    const _u8x16 incomplete_max = _u8x16_load(_utf8_incomplete_max);
+    _u8x16 prev = _u8x16_splat(0), error = _u8x16_splat(0), prev_incomplete = _u8x16_splat(0);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _u8x16 in = _u8x16_load(s + i);
+        if (_u8x16_has_high_bit(in)) {
+            error = _u8x16_or(error, _utf8_check_block(in, prev, tables));
+            prev_incomplete = _u8x16_subs(in, incomplete_max);
+        } else {
+            error = _u8x16_or(error, prev_incomplete);  // Only a continuation could follow
+        }
+        prev = in;
+    }
+
+    if (i < n) {  // The zeros after the tail also catch a character cut short at the end
+        uint8_t tail[16] = {0};
+        memcpy(tail, s + i, n - i);
+        error = _u8x16_or(error, _utf8_check_block(_u8x16_load(tail), prev, tables));
+    } else {
+        error = _u8x16_or(error, prev_incomplete);
+    }
+    return !_u8x16_any(error);
+}
+#endif
+
+bool String_utf8_valid(String s) {
+    size_t n = strlen(s);
+#if defined(__SSSE3__) || (defined(__ARM_NEON) && defined(__aarch64__))
+    return _utf8_valid_simd(s, n);
+#else
+#if defined(_UTF8_SIMD)
+    if (__builtin_cpu_supports("ssse3")) return _utf8_valid_simd(s, n);
+#endif
+    const unsigned char *p = (const unsigned char*)s, *last = p + n;
+    while (p < last) {
+        p += _ascii_prefix((const char*)p, last - p);
+        if (p == last) break;
+        uint32_t cp;
+        size_t k = _utf8_decode(p, last, &cp);
+        if (k == 0) return false;
+        p += k;
+    }
+    return true;
+#endif
+}
+
+// Number of bytes that do not continue a character (10xxxxxx) in one word
+static inline size_t _utf8_count_word(uint64_t w) {
+    return 8 - __builtin_popcountll(w & ~(w << 1) & _HIGH_BITS);
+}
+
+size_t String_utf8_len(String s) {
+    size_t n = strlen(s), count = 0, i = 0;
+    for (; i + 8 <= n; i += 8) count += _utf8_count_word(_load_u64_le(s + i));
+    for (; i < n; i++) count += ((unsigned char)s[i] & 0xC0) != 0x80;
+    return count;
+}
+
+#define _UTF8_INDEX_STEP 64
+
+// Byte offset of every 64th character, so that String_utf8_slice only has to walk 63 at most
+size_t* String_utf8_index(String s) {
+    size_t n = strlen(s);
+    size_t* index = _List_new(sizeof(size_t), n / _UTF8_INDEX_STEP + 2);
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (((unsigned char)s[i] & 0xC0) == 0x80) continue;
+        if (count++ % _UTF8_INDEX_STEP == 0) List_append(index, i);
+    }
+    return index;
+}
+
+// Byte offset of character `target`, walking from character `from` at byte `offset`
+static size_t _utf8_offset(String s, size_t n, size_t offset, size_t from, size_t target) {
+    while (from + 8 <= target && offset + 8 <= n) {
+        size_t count = _utf8_count_word(_load_u64_le(s + offset));
+        if (from + count > target) break;
+        from += count;
+        offset += 8;
+    }
+    while (offset < n && (((unsigned char)s[offset] & 0xC0) == 0x80 || from < target)) {
+        if (((unsigned char)s[offset] & 0xC0) != 0x80) from++;
+        offset++;
+    }
+    return offset;
+}
+
+String String_utf8_slice(String s, int start, int last, size_t* index) {
+    size_t n = strlen(s);
+    if (index == NULL && _ascii_prefix(s, n) == n) return String_slice(s, start, last, 1);
+
+    size_t len_s;
+    if (index == NULL) {
+        len_s = String_utf8_len(s);
+    } else if (len(index) == 0) {
+        len_s = 0;
+    } else {
+        size_t base = (len(index) - 1) * _UTF8_INDEX_STEP, offset = index[len(index) - 1];
+        len_s = base + String_utf8_len(s + offset);
+    }
+    if (start < 0) start += len_s;
+    if (last < 0) last += len_s + 1;
+
+    if (start == last) return String_new("");
+    assert(start >= 0 && start < len_s);
+    assert(last > 0 && last <= len_s);
+    assert(last > start);
+
+    size_t from = 0, offset = 0;
+    if (index != NULL) {
+        from = start / _UTF8_INDEX_STEP * _UTF8_INDEX_STEP;
+        offset = index[start / _UTF8_INDEX_STEP];
+    }
+    size_t begin = _utf8_offset(s, n, offset, from, start);
+    size_t end = _utf8_offset(s, n, begin, start, last);
+    return _String_from_range(s + begin, end - begin);
+}
+
+// Simple (one to one) case mappings for Latin-1, Latin Extended-A, Greek and Cyrillic
+static uint32_t _utf8_lower(uint32_t cp) {
+    if (cp >= 'A' && cp <= 'Z') return cp + 32;
+    if (cp < 0xC0) return cp;
+    if (cp <= 0xDE) return cp == 0xD7 ? cp : cp + 32;
+    if (cp == 0x130) return 'i';
+    if ((cp >= 0x100 && cp <= 0x137) || (cp >= 0x14A && cp <= 0x177))
+        return cp == 0x131 ? cp : cp | 1;
+    if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) return cp + (cp & 1);
+    if (cp == 0x178) return 0xFF;
+    if (cp == 0x386) return 0x3AC;
+    if (cp >= 0x388 && cp <= 0x38A) return cp + 37;
+    if (cp == 0x38C) return 0x3CC;
+    if (cp == 0x38E || cp == 0x38F) return cp + 63;
+    if (cp >= 0x391 && cp <= 0x3AB && cp != 0x3A2) return cp + 32;
+    if (cp >= 0x400 && cp <= 0x40F) return cp + 80;
+    if (cp >= 0x410 && cp <= 0x42F) return cp + 32;
+    return cp;
+}
+
+static uint32_t _utf8_upper(uint32_t cp) {
+    if (cp >= 'a' && cp <= 'z') return cp - 32;
+    if (cp < 0xB5) return cp;
+    if (cp == 0xB5) return 0x39C;
+    if (cp >= 0xE0 && cp <= 0xFE) return cp == 0xF7 ? cp : cp - 32;
+    if (cp == 0xFF) return 0x178;
+    if (cp == 0x131) return 'I';
+    if (cp == 0x17F) return 'S';
+    if ((cp >= 0x100 && cp <= 0x137) || (cp >= 0x14A && cp <= 0x177))
+        return cp == 0x130 ? cp : cp & ~1u;
+    if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) return cp - !(cp & 1);
+    if (cp == 0x3AC) return 0x386;
+    if (cp >= 0x3AD && cp <= 0x3AF) return cp - 37;
+    if (cp == 0x3C2) return 0x3A3;
+    if (cp == 0x3CC) return 0x38C;
+    if (cp == 0x3CD || cp == 0x3CE) return cp - 63;
+    if (cp >= 0x3B1 && cp <= 0x3CB) return cp - 32;
+    if (cp >= 0x430 && cp <= 0x44F) return cp - 32;
+    if (cp >= 0x450 && cp <= 0x45F) return cp - 80;
+    return cp;
+}
+
+static uint32_t _utf8_casefold(uint32_t cp) {
+    if (cp == 0xB5) return 0x3BC;
+    if (cp == 0x17F) return 's';
+    if (cp == 0x3C2) return 0x3C3;
+    return _utf8_lower(cp);
+}
+
+// None of the mappings above make a character longer, so the result fits in strlen(s) bytes
+static String _String_utf8_map(String s, uint32_t (*map)(uint32_t)) {
+    size_t n = strlen(s);
+    String result = _List_new(sizeof(char), n + 1);
+    const unsigned char *p = (const unsigned char*)s, *last = p + n;
+    char* out = result;
+
+    while (p < last) {
+        if (*p < 0x80) {
+            *out++ = map(*p++);
+            continue;
+        }
+        uint32_t cp;
+        size_t k = _utf8_decode(p, last, &cp);
+        if (k == 0) {  // Invalid bytes are copied as they are
+            *out++ = *p++;
+            continue;
+        }
+        out += _utf8_encode(map(cp), out);
+        p += k;
+    }
+
+    *out = 0;
+    _List_get_header(result)->length = out - result;
+    return result;
+}
+
+String String_utf8_upper(String s) {
+    if (_ascii_prefix(s, strlen(s)) == strlen(s)) return String_upper(s);
+    return _String_utf8_map(s, _utf8_upper);
+}
+
+String String_utf8_lower(String s) {
+    if (_ascii_prefix(s, strlen(s)) == strlen(s)) return String_lower(s);
+    return _String_utf8_map(s, _utf8_lower);
+}
+
+String String_utf8_casefold(String s) {
+    if (_ascii_prefix(s, strlen(s)) == strlen(s)) return String_lower(s);
+    return _String_utf8_map(s, _utf8_casefold);
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -90,6 +91,30 @@ typedef bool (*cmp_fn_t)(void*, void*);
 
 #define List_sort(list, cmp_fn) _List_sort((list), (int (*)(const void*, const void*))(cmp_fn))
 
+// Sorted lists (sorted with the same cmp_fn given to List_sort)
+
+typedef int (*sort_fn_t)(const void*, const void*);
+#define List_bsearch(list, value, cmp_fn) \
+    _List_bsearch((list), &(__typeof__((list)[0])){(value)}, (sort_fn_t)(cmp_fn))
+#define List_lower_bound(list, value, cmp_fn) \
+    _List_lower_bound((list), &(__typeof__((list)[0])){(value)}, (sort_fn_t)(cmp_fn), false)
+#define List_upper_bound(list, value, cmp_fn) \
+    _List_lower_bound((list), &(__typeof__((list)[0])){(value)}, (sort_fn_t)(cmp_fn), true)
+#define List_eytzinger(list) ((typeof(list))_List_eytzinger((list)))
+#define List_eytzinger_search(list, value, cmp_fn) \
+    _List_eytzinger_search((list), &(__typeof__((list)[0])){(value)}, (sort_fn_t)(cmp_fn))
+#define List_unique(list, cmp_fn) _List_unique((list), (sort_fn_t)(cmp_fn))
+#define List_merge_sorted(list1, list2, cmp_fn) \
+    ((typeof(list1))_List_set_op((list1), (list2), (sort_fn_t)(cmp_fn), _SET_MERGE))
+#define List_union(list1, list2, cmp_fn) \
+    ((typeof(list1))_List_set_op((list1), (list2), (sort_fn_t)(cmp_fn), _SET_UNION))
+#define List_intersection(list1, list2, cmp_fn) \
+    ((typeof(list1))_List_set_op((list1), (list2), (sort_fn_t)(cmp_fn), _SET_INTERSECTION))
+#define List_difference(list1, list2, cmp_fn) \
+    ((typeof(list1))_List_set_op((list1), (list2), (sort_fn_t)(cmp_fn), _SET_DIFFERENCE))
+
+typedef enum { _SET_MERGE, _SET_UNION, _SET_INTERSECTION, _SET_DIFFERENCE } _SetOp;
+
 void* _List_new(size_t element_size, size_t length);
 void* List_resize(void* list, size_t new_capacity);
 _ListHeader* _List_get_header(void* list);
@@ -105,6 +130,113 @@ int _List_index_fn(void* list, void* value, bool (*cmp_fn)(void*, void*));
 void* _List_repeat(void* list, size_t count);
 void* _List_copy(void* list);
 void _List_sort(void* list, int (*cmp_fn)(const void*, const void*));
+int _List_bsearch(void* list, const void* value, sort_fn_t cmp_fn);
+size_t _List_lower_bound(void* list, const void* value, sort_fn_t cmp_fn, bool upper);
+void* _List_eytzinger(void* list);
+int _List_eytzinger_search(void* list, const void* value, sort_fn_t cmp_fn);
+void _List_unique(void* list, sort_fn_t cmp_fn);
+void* _List_set_op(void* list1, void* list2, sort_fn_t cmp_fn, _SetOp op);
+
+// Bit list stuff
+
+// A list of 64-bit words holding one bool per bit. len() gives the number of bits and the
+// capacity counts words. Only use BitList_* functions on it, together with len and List_free.
+typedef uint64_t* BitList;
+
+#define BitList_append(bits, value) \
+    { bits = _BitList_append((bits), (value)); }
+
+BitList BitList_new(size_t length);  // All bits set to false
+BitList _BitList_append(BitList bits, bool value);
+bool BitList_get(BitList bits, size_t i);
+void BitList_set(BitList bits, size_t i, bool value);
+size_t BitList_count(BitList bits);
+size_t BitList_find_next_set(BitList bits, size_t from);  // len(bits) if there is none
+void BitList_and(BitList bits, BitList other);            // In place, like bits &= other
+void BitList_or(BitList bits, BitList other);
+void BitList_xor(BitList bits, BitList other);
+void BitList_not(BitList bits);
+BitList BitList_copy(BitList bits);
+BitList BitList_from_bools(bool* list);
+bool* BitList_to_bools(BitList bits);
+
+// Struct of arrays stuff
+
+// SOA_LIST(Row, (int, id), (double, price)) defines `struct Row` and `RowSoA`, which stores one
+// list per field (rows.id, rows.price). The lists always have the same length, so each column can
+// be read like any other list, but only RowSoA_* functions may add rows.
+#define SOA_LIST(Name, ...)                                                            \
+    typedef struct Name {                                                              \
+        _SOA_MAP(_SOA_FIELD, __VA_ARGS__)                                              \
+    } Name;                                                                            \
+    typedef struct Name##SoA {                                                         \
+        _SOA_MAP(_SOA_COLUMN, __VA_ARGS__)                                             \
+    } Name##SoA;                                                                       \
+    static inline Name##SoA Name##SoA_new(void) {                                      \
+        return (Name##SoA){_SOA_MAP(_SOA_NEW, __VA_ARGS__)};                           \
+    }                                                                                  \
+    static inline size_t Name##SoA_len(Name##SoA* soa) {                               \
+        return len(soa->_SOA_NAME(_SOA_FIRST(__VA_ARGS__)));                           \
+    }                                                                                  \
+    static inline void Name##SoA_append(Name##SoA* soa, Name row) {                    \
+        _SOA_MAP(_SOA_APPEND, __VA_ARGS__)                                             \
+    }                                                                                  \
+    static inline Name Name##SoA_get_row(Name##SoA* soa, int idx) {                    \
+        size_t i = _List_convert_idx(soa->_SOA_NAME(_SOA_FIRST(__VA_ARGS__)), idx,     \
+                                     __func__, __FILE_NAME__, __LINE__);               \
+        return (Name){_SOA_MAP(_SOA_GET, __VA_ARGS__)};                                \
+    }                                                                                  \
+    static inline void Name##SoA_set_row(Name##SoA* soa, int idx, Name row) {          \
+        size_t i = _List_convert_idx(soa->_SOA_NAME(_SOA_FIRST(__VA_ARGS__)), idx,     \
+                                     __func__, __FILE_NAME__, __LINE__);               \
+        _SOA_MAP(_SOA_SET, __VA_ARGS__)                                                \
+    }                                                                                  \
+    static inline void Name##SoA_free(Name##SoA* soa) { _SOA_MAP(_SOA_FREE, __VA_ARGS__) }
+
+// Each field is a (type, name) pair, unpacked by `_SOA_X_ field`
+#define _SOA_FIELD(field) _SOA_FIELD_ field
+#define _SOA_FIELD_(type, name) type name;
+#define _SOA_COLUMN(field) _SOA_COLUMN_ field
+#define _SOA_COLUMN_(type, name) type* name;
+#define _SOA_NEW(field) _SOA_NEW_ field
+#define _SOA_NEW_(type, name) .name = List_new(type),
+#define _SOA_APPEND(field) _SOA_APPEND_ field
+#define _SOA_APPEND_(type, name) List_append(soa->name, row.name);
+#define _SOA_GET(field) _SOA_GET_ field
+#define _SOA_GET_(type, name) .name = soa->name[i],
+#define _SOA_SET(field) _SOA_SET_ field
+#define _SOA_SET_(type, name) soa->name[i] = row.name;
+#define _SOA_FREE(field) _SOA_FREE_ field
+#define _SOA_FREE_(type, name) List_free(gc_keep(soa->name));  // Untracked first, or gc frees it again
+#define _SOA_NAME(field) _SOA_NAME_ field
+#define _SOA_NAME_(type, name) name
+#define _SOA_FIRST(first, ...) first
+
+#define _SOA_MAP(m, ...)                                                                       \
+    _SOA_MAP_impl(__VA_ARGS__, _SOA_MAP_16, _SOA_MAP_15, _SOA_MAP_14, _SOA_MAP_13, _SOA_MAP_12, \
+                  _SOA_MAP_11, _SOA_MAP_10, _SOA_MAP_9, _SOA_MAP_8, _SOA_MAP_7, _SOA_MAP_6,     \
+                  _SOA_MAP_5, _SOA_MAP_4, _SOA_MAP_3, _SOA_MAP_2, _SOA_MAP_1)(m, __VA_ARGS__)
+
+#define _SOA_MAP_impl(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, \
+                      ...)                                                                      \
+    N
+
+#define _SOA_MAP_1(m, _1) m(_1)
+#define _SOA_MAP_2(m, _1, ...) m(_1) _SOA_MAP_1(m, __VA_ARGS__)
+#define _SOA_MAP_3(m, _1, ...) m(_1) _SOA_MAP_2(m, __VA_ARGS__)
+#define _SOA_MAP_4(m, _1, ...) m(_1) _SOA_MAP_3(m, __VA_ARGS__)
+#define _SOA_MAP_5(m, _1, ...) m(_1) _SOA_MAP_4(m, __VA_ARGS__)
+#define _SOA_MAP_6(m, _1, ...) m(_1) _SOA_MAP_5(m, __VA_ARGS__)
+#define _SOA_MAP_7(m, _1, ...) m(_1) _SOA_MAP_6(m, __VA_ARGS__)
+#define _SOA_MAP_8(m, _1, ...) m(_1) _SOA_MAP_7(m, __VA_ARGS__)
+#define _SOA_MAP_9(m, _1, ...) m(_1) _SOA_MAP_8(m, __VA_ARGS__)
+#define _SOA_MAP_10(m, _1, ...) m(_1) _SOA_MAP_9(m, __VA_ARGS__)
+#define _SOA_MAP_11(m, _1, ...) m(_1) _SOA_MAP_10(m, __VA_ARGS__)
+#define _SOA_MAP_12(m, _1, ...) m(_1) _SOA_MAP_11(m, __VA_ARGS__)
+#define _SOA_MAP_13(m, _1, ...) m(_1) _SOA_MAP_12(m, __VA_ARGS__)
+#define _SOA_MAP_14(m, _1, ...) m(_1) _SOA_MAP_13(m, __VA_ARGS__)
+#define _SOA_MAP_15(m, _1, ...) m(_1) _SOA_MAP_14(m, __VA_ARGS__)
+#define _SOA_MAP_16(m, _1, ...) m(_1) _SOA_MAP_15(m, __VA_ARGS__)
 
 // String stuff
 
@@ -129,6 +261,13 @@ bool String_startswith(String s, String prefix);
 bool String_endswith(String s, String suffix);
 bool String_contains(String s, char c);
 String String_strip(String s, char* characters);
+bool String_utf8_valid(String s);
+size_t String_utf8_len(String s);
+size_t* String_utf8_index(String s);
+String String_utf8_slice(String s, int start, int last, size_t* index);  // index can be NULL
+String String_utf8_upper(String s);
+String String_utf8_lower(String s);
+String String_utf8_casefold(String s);
 /*
 center()
 count()
@@ -168,13 +307,64 @@ title()
         memcpy((s1) + head->length, (s2), strlen(s2));                                     \
     }
 
+// Parsing stuff
+
+// Parse a number from [first, last) without looking at the locale. Returns a pointer past the
+// last character used, or NULL if no number could be read (or it overflows).
+const char* String_to_i64(const char* first, const char* last, int64_t* value);
+const char* String_to_f64(const char* first, const char* last, double* value);
+// text must be a String (not a char*), its length comes from the header. Returns NULL if a token
+// is not a number, an int is out of range, or a field is empty ("1,,2").
+int* List_parse_ints(String text, char sep);
+double* List_parse_doubles(String text, char sep);
+// Fields can be quoted (RFC 4180). Unquoted 's' fields keep their spaces, numbers are trimmed.
+// Empty fields read as 0, NAN or "". Returns NULL if a field is not a number of its column's type,
+// a row has too few or too many fields, or a quote is never closed.
+void** CSV_columns(String text, char sep, const char* types, bool header);
+
+// File stuff
+
+typedef struct Line {
+    size_t offset;  // Position of the line in the file
+    size_t length;  // Without the trailing "\n" or "\r\n"
+} Line;
+
+typedef struct File {
+    const char* data;  // Memory-mapped content (read-only)
+    size_t size;
+    Line* lines;
+} File;
+
+typedef struct FileLineIter {
+    int fd;
+    char* buffer;
+    size_t capacity, start, end;  // Unread bytes are buffer[start, end)
+    bool eof;
+    bool error;  // A read failed, so File_next_line stopped before the end of the file
+} FileLineIter;
+
+// Files and iterators are tracked by the GC: call gc_keep on them before File_free or
+// File_line_iter_free, as with List_free
+File* File_lines(const char* path);  // NULL if the file cannot be opened
+String File_line(File* file, int i);
+void File_free(File* file);
+FileLineIter* File_line_iter(const char* path);  // NULL if the file cannot be opened
+// false at the end of the file, or on a read error (it->error is then set)
+bool File_next_line(FileLineIter* it, const char** line, size_t* length);
+void File_line_iter_free(FileLineIter* it);
+
 // Garbage collector stuff
 
 typedef void (*free_fn_t)(void*);
+typedef void (*children_fn_t)(void* p, void (*visit)(void* child));
 void* gc_track(void* p, free_fn_t free_fn);  // Start tracking object for collection
 void gc_frame(void);                         // Create new garbage collection layer
 void* gc_keep(void* p);                      // Stop tracking object
 void* gc_collect(void* p);                   // Collect and move object to previous collection layer
+void gc_collect_many(void** ptrs, size_t n);  // Same as gc_collect, for n objects
+void* gc_escape(void* p);  // Move object to previous collection layer on next collect
+void* gc_children(void* p, children_fn_t children_fn);  // Escape visited children along with p
+void List_children(void* list, void (*visit)(void*));   // children_fn for lists of pointers
 void* gc_calloc(size_t count, size_t size);  // Garbage collected calloc
 void* gc_malloc(size_t size);                // Garbage collected malloc
 void* gc_realloc(void* ptr, size_t size);    // Garbage collected realloc